@@ -1,6 +1,7 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#include <cstddef>
 #include <vector>
 
 namespace mandlebrot
@@ -31,6 +32,11 @@ namespace mandlebrot
 
     extern const int BAILOUT_RADIUS;
 
+    extern const char  *poster_file;
+    extern const int    poster_width;
+    extern const size_t poster_tile_budget;
+    extern const int    poster_histogram_samples;
+
     //Color palette in RGB
     //Top row is min iterations to escape
     //Bottom row is max iterations to escape
@@ -0,0 +1,35 @@
+#ifndef  POSTER_H
+#define POSTER_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace mandlebrot
+{
+    //the view to render, the poster size and bands come from config.h
+    struct poster_job
+    {
+        std::string path;
+        int    order;
+        size_t nIter;
+        bool   histogram_color;
+        double modulo_blending;
+        double x_min;
+        double x_max;
+        double y_min;
+        double y_max;
+        std::vector< std::vector <unsigned char> > colors;
+    };
+
+    //renders job to a poster_width x poster_width PNG at job.path a band of rows at a time,
+    //streaming each band into the file so memory stays within poster_tile_budget.
+    //progress is checkpointed to job.path + ".ckpt" after every band.
+    //setting cancel stops it at the current band, leaving the checkpoint to resume from
+    bool export_poster(const poster_job &job, const std::atomic<bool> &cancel);
+
+    //picks an interrupted export back up from the checkpoint export_poster left behind
+    bool resume_poster(const std::string &checkpoint);
+}
+
+#endif
@@ -2,10 +2,56 @@
 #define RENDERING_H
 
 #include "SDL.h"
+#include <cmath>
+#include <complex>
 #include <vector>
 
+#include "config.h"
+
 namespace mandlebrot
 {
+    //smoothed number of iterations for cp to escape, nIter if it never does
+    //shared by the live view and poster export so both see the same fractal
+    inline double escape_time(const std::complex<double> &cp, int order, size_t nIter)
+    {
+        size_t k = 0;
+        // cardiod improvement for 2nd order
+        if (order == 2)
+        {
+            const double q = (cp.real() - 1.0/4.0)* ( cp.real() - 1.0/4.0)
+                            + cp.imag() * cp.imag();
+            if (4 * q*(q+(cp.real() - 1.0/4.0)) <= cp.imag() * cp.imag())
+            {
+                k = nIter;
+            }
+        }
+        std::complex<double> cp_iterate(cp);
+        while(k < nIter && abs(cp_iterate) < mandlebrot::BAILOUT_RADIUS)
+        {
+            cp_iterate = std::pow(cp_iterate, order) + cp;
+            k += 1;
+        }
+        if (k == nIter)
+        {
+            return k;
+        }
+        const double log_zn = std::log(std::abs(cp_iterate));
+        const double nu     = (std::log(log_zn)-std::log(mandlebrot::BAILOUT_RADIUS))/std::log(order);
+        return k + 1 - nu;
+    }
+
+    std::vector<double> histogram_buckets ( const std::vector< std::vector <unsigned char> > &current_colors,
+                                            const std::vector<double> &iterations, int nIter );
+
+    //per pixel coloring, rgb is indexed by RED, GREEN, BLUE
+    void histogram_color  ( const std::vector< std::vector <unsigned char> > &current_colors,
+                            const std::vector<double> &buckets, double iteration, int nIter,
+                            unsigned char rgb[3] );
+
+    void modulo_color     ( const std::vector< std::vector <unsigned char> > &current_colors,
+                            double iteration, int nIter, double modulo_blend,
+                            unsigned char rgb[3] );
+
     void histogram_render ( const std::vector< std::vector <unsigned char> > &current_colors,
                             const std::vector<double> &iterations, int nIter,
                             SDL_Renderer *renderer );
@@ -0,0 +1,95 @@
+#ifndef  TRACE_H
+#define TRACE_H
+
+#include "SDL.h"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace mandlebrot
+{
+    //everything the event loop can change in response to input
+    //it is recorded after each event so a replay can detect divergence
+    struct view_state
+    {
+        double x_min;
+        double x_max;
+        double y_min;
+        double y_max;
+        size_t nIter;
+        double modulo_blending;
+        bool   histogram_color;
+    };
+
+    bool operator==(const view_state &a, const view_state &b);
+    bool operator!=(const view_state &a, const view_state &b);
+
+    //only quitting, clicking and key presses drive the explorer, everything else is dropped
+    bool is_traced_event(const SDL_Event &e);
+
+    //writes every traced event and the view state it produced to a text file
+    //each event is tagged with the main loop pass it was handled in
+    class trace_recorder
+    {
+        public:
+            explicit trace_recorder(const std::string &path);
+            bool good() const;
+
+            //call once per main loop, at the same point trace_player::frame_done is called
+            void tick();
+            void record(const SDL_Event &e, const view_state &state);
+
+        private:
+            std::ofstream out;
+            size_t loop;
+    };
+
+    //feeds a recorded trace back into the SDL event queue on the same main loop passes
+    //it was handled on, so the explorer sees the same events, idle loops and periodic
+    //refreshes regardless of how fast this machine renders.
+    //latency of an event is measured from when its batch was pushed to when the
+    //main loop comes back around after handling (and rendering) it
+    class trace_player
+    {
+        public:
+            explicit trace_player(const std::string &path);
+            bool good() const;
+
+            //true once every recorded event has been replayed and measured
+            bool done() const;
+
+            //call once per main loop after rendering; closes out the in flight batch
+            //and pushes the next one if it was recorded on this loop
+            void frame_done();
+
+            //compare the state after handling an event with what was recorded
+            void check(const SDL_Event &e, const view_state &state);
+
+            //prints latency percentiles and session time, false if the replay diverged
+            bool report(std::ostream &os) const;
+
+        private:
+            struct entry
+            {
+                size_t     loop;
+                SDL_Event  event;
+                view_state state;
+            };
+
+            bool loaded;
+            std::vector<entry>  entries;
+            std::vector<double> latencies_ms;
+            size_t loop;
+            size_t next_push;
+            size_t next_check;
+            size_t in_flight_begin;
+            size_t divergences;
+            std::chrono::steady_clock::time_point pushed_at;
+            std::chrono::steady_clock::time_point start;
+            std::chrono::steady_clock::time_point end;
+    };
+}
+
+#endif
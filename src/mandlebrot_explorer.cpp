@@ -1,16 +1,22 @@
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cmath>
 #include <complex>
+#include <cstdlib>
 #include <iostream>
 #include <iomanip>
+#include <memory>
+#include <string>
 #include <thread>
 #include <vector>
 
 #include "SDL.h"
 
 #include "config.h"
+#include "poster.h"
 #include "rendering.h"
+#include "trace.h"
 
 static const std::string program_name = "Mandlebrot Explorer";
 static constexpr int MAX_LOOPS_WITHOUT_REFRESH = 5;
@@ -18,8 +24,48 @@ static constexpr int MAX_LOOPS_WITHOUT_REFRESH = 5;
 // TODO: Rerender somewhat regularly to avoid dragging a window over the screen
 // from causing issues
 
-int main()
+static void print_usage(const char *argv0)
 {
+    std::cerr << "usage: " << argv0 << " [--record <trace>] [--replay <trace>] [--resume-poster <checkpoint>]\n"
+              << "  --record <trace>             : save every input and the view it produced to <trace>\n"
+              << "  --replay <trace>             : drive the explorer headlessly from <trace> and report latency\n"
+              << "  --resume-poster <checkpoint> : finish an interrupted poster export without opening a window\n";
+}
+
+int main(int argc, char *argv[])
+{
+    std::unique_ptr<mandlebrot::trace_recorder> recorder;
+    std::unique_ptr<mandlebrot::trace_player>   player;
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        const std::string flag = argv[arg];
+        if ((flag == "--record" || flag == "--replay" || flag == "--resume-poster") && arg + 1 < argc)
+        {
+            arg += 1;
+            if (flag == "--resume-poster")
+            {
+                return mandlebrot::resume_poster(argv[arg]) ? 0 : 1;
+            }
+            else if (flag == "--record")
+            {
+                recorder = std::make_unique<mandlebrot::trace_recorder>(argv[arg]);
+                if (!recorder->good())
+                    return -1;
+            }
+            else
+            {
+                player = std::make_unique<mandlebrot::trace_player>(argv[arg]);
+                if (!player->good())
+                    return -1;
+            }
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
 
     bool recalculate = true;
     bool redraw      = true;
@@ -55,6 +101,15 @@ int main()
         current_colors = mandlebrot::color_maps[current_map];
     }
 
+    // replays run on headless machines, a SDL_VIDEODRIVER already set by the user takes precedence
+    // the dummy driver has no OpenGL so fall back to the software renderer
+    Uint32 window_flags = SDL_WINDOW_OPENGL;
+    if (player)
+    {
+        setenv("SDL_VIDEODRIVER", "dummy", 0);
+        window_flags = 0;
+    }
+
     if (SDL_Init(SDL_INIT_VIDEO) != 0)
     {
         std::cerr << "SDL_Init(SDL_INIT_VIDEO)\n";
@@ -67,7 +122,7 @@ int main()
 
     SDL_CreateWindowAndRenderer(mandlebrot::pixelWidth,
                                 mandlebrot::pixelWidth,
-                                SDL_WINDOW_OPENGL,
+                                window_flags,
                                 &window,
                                 &renderer);
 
@@ -82,6 +137,11 @@ int main()
 
     SDL_SetWindowPosition(window, 10, 10);
 
+    // poster exports run beside the event loop so the window stays responsive
+    std::thread       poster_thread;
+    std::atomic<bool> poster_cancel(false);
+    std::atomic<bool> poster_running(false);
+
     while (!quit)
     {
         if (recalculate)
@@ -101,31 +161,7 @@ int main()
                 for (int j = 0; j < mandlebrot::pixelWidth; j++)
                 {
                     const auto cp = std::complex<double>(x_min+j*x_inc, y_max-i*y_inc);
-                    size_t k = 0;
-                    // cardiod improvement for 2nd order
-                    if (order == 2)
-                    {
-                        const double q = (cp.real() - 1.0/4.0)* ( cp.real() - 1.0/4.0)
-                                        + cp.imag() * cp.imag();
-                        if (4 * q*(q+(cp.real() - 1.0/4.0)) <= cp.imag() * cp.imag())
-                        {
-                            k = nIter;
-                        }
-                    }
-                    std::complex<double> cp_iterate(cp);
-                    while(k < nIter && abs(cp_iterate) < mandlebrot::BAILOUT_RADIUS)
-                    {
-                        cp_iterate = std::pow(cp_iterate, order) + cp;
-                        k += 1;
-                    }
-                    if (k == nIter)
-                    {
-                        iterations[i*mandlebrot::pixelWidth+j] = k;
-                        continue;
-                    }
-                    const double log_zn = std::log(std::abs(cp_iterate));
-                    const double nu     = (std::log(log_zn)-std::log(mandlebrot::BAILOUT_RADIUS))/std::log(order);
-                    iterations[i*mandlebrot::pixelWidth+j] = k + 1 - nu;
+                    iterations[i*mandlebrot::pixelWidth+j] = mandlebrot::escape_time(cp, order, nIter);
                 }
             }
             recalculate = false;
@@ -153,9 +189,23 @@ int main()
         }
         loops_without_refresh += 1;
 
+        if (recorder)
+        {
+            recorder->tick();
+        }
+        if (player)
+        {
+            player->frame_done();
+            if (player->done())
+            {
+                quit = true;
+            }
+        }
+
         std::this_thread::sleep_for(std::chrono::milliseconds(5));
 
-        SDL_SetWindowTitle(window, program_name.c_str());
+        SDL_SetWindowTitle(window, (poster_running ? program_name + std::string( ": exporting poster")
+                                                   : program_name).c_str());
         SDL_PumpEvents();
 
         // catch multiple inputs in succession
@@ -233,6 +283,38 @@ int main()
                                   << "modulo_blending     = " << modulo_blending << std::endl;
                         break;
 
+                    // render the current view as a poster, or cancel the one in progress
+                    case SDLK_e:
+                    {
+                        // an export would swamp the latency being measured
+                        if (player)
+                        {
+                            std::cout << "poster: export skipped during replay" << std::endl;
+                            break;
+                        }
+                        if (poster_running)
+                        {
+                            poster_cancel = true;
+                            break;
+                        }
+                        if (poster_thread.joinable())
+                        {
+                            poster_thread.join();
+                        }
+
+                        const mandlebrot::poster_job job = {mandlebrot::poster_file, order, nIter,
+                                                            histogram_color, modulo_blending,
+                                                            x_min, x_max, y_min, y_max, current_colors};
+                        poster_cancel  = false;
+                        poster_running = true;
+                        poster_thread  = std::thread([job, &poster_cancel, &poster_running] ()
+                        {
+                            mandlebrot::export_poster(job, poster_cancel);
+                            poster_running = false;
+                        });
+                        break;
+                    }
+
                     // print controls
                     case SDLK_t:
                         std::cout << "----------------------------------------------------------------------\n"
@@ -249,6 +331,7 @@ int main()
                                   << "Nums 1-4  : toggle between precoded color maps in src/config.cpp\n"
                                   << "r         : reset to default view\n"
                                   << "p         : print current state\n"
+                                  << "e         : export the current view as a poster, again to cancel\n"
                                   << "q         : quit\n"
                                   << "t         : pull up this menu" << std::endl;
                         break;
@@ -477,12 +560,41 @@ int main()
                         break;
                 }
             }
+
+            if (recorder || player)
+            {
+                const mandlebrot::view_state state = {x_min, x_max, y_min, y_max, nIter,
+                                                      modulo_blending, histogram_color};
+                if (recorder)
+                {
+                    recorder->record(e, state);
+                }
+                if (player)
+                {
+                    player->check(e, state);
+                }
+            }
         }
     }
+
+    // quitting mid export leaves its checkpoint to resume from
+    if (poster_thread.joinable())
+    {
+        poster_cancel = true;
+        poster_thread.join();
+    }
+
+    int ret = 0;
+    if (player)
+    {
+        // a quit in the trace leaves its batch unmeasured
+        player->frame_done();
+        ret = player->report(std::cout) ? 0 : 1;
+    }
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
 
     SDL_Quit();
 
-    return 0;
+    return ret;
 }
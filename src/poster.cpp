@@ -0,0 +1,508 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "zlib.h"
+
+#include "config.h"
+#include "poster.h"
+#include "rendering.h"
+
+static const std::string checkpoint_magic   = "mandlebrot_poster";
+static constexpr int     checkpoint_version = 2;
+
+//how far along an export is, rewritten after every band
+//offset is where the next band's IDAT chunks start, adler is the zlib checksum up to there
+//histogram_samples and bailout are kept so a resume colors exactly like the bands already written
+struct poster_progress
+{
+    int            width;
+    size_t         band_rows;
+    int            histogram_samples;
+    int            bailout;
+    size_t         bands_done;
+    std::uintmax_t offset;
+    uLong          adler;
+};
+
+static std::string checkpoint_path(const std::string &path)
+{
+    return path + ".ckpt";
+}
+
+//exports run beside the event loop, whose 'p' handler switches std::cout to hex,
+//so progress is formatted here and written unformatted in one piece
+static void poster_log(const std::string &message)
+{
+    const std::string line = "poster: " + message + "\n";
+    std::cout.write(line.data(), static_cast<std::streamsize>(line.size()));
+    std::cout.flush();
+}
+
+//flushing a stream only hands the data to the OS, fsync makes sure it reached the disk
+//before a checkpoint is allowed to point at it
+static bool sync_file(const std::string &path)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << "could not open " << path << " to sync it\n";
+        return false;
+    }
+    const bool synced = ::fsync(fd) == 0;
+    ::close(fd);
+    if (!synced)
+    {
+        std::cerr << "could not sync " << path << "\n";
+    }
+    return synced;
+}
+
+static bool write_checkpoint(const mandlebrot::poster_job &job, const poster_progress &progress)
+{
+    // write next to the old one and swap, so a crash mid write keeps the last good checkpoint
+    const std::string ckpt = checkpoint_path(job.path);
+    const std::string tmp  = ckpt + ".tmp";
+    {
+        std::ofstream out(tmp);
+        out.precision(std::numeric_limits<double>::max_digits10);
+        out << checkpoint_magic << " " << checkpoint_version << "\n"
+            << job.path << "\n"
+            << progress.width << " " << progress.band_rows << " "
+            << progress.histogram_samples << " " << progress.bailout << " " << job.order << " " << job.nIter << " "
+            << job.histogram_color << " " << job.modulo_blending << "\n"
+            << job.x_min << " " << job.x_max << " " << job.y_min << " " << job.y_max << "\n"
+            << job.colors.size();
+        for (const auto &c : job.colors)
+        {
+            out << " " << static_cast<int>(c[mandlebrot::RED])
+                << " " << static_cast<int>(c[mandlebrot::GREEN])
+                << " " << static_cast<int>(c[mandlebrot::BLUE]);
+        }
+        out << "\n"
+            << progress.bands_done << " " << progress.offset << " " << progress.adler << "\n";
+        if (!out.flush())
+        {
+            std::cerr << "could not write poster checkpoint " << tmp << "\n";
+            return false;
+        }
+    }
+    if (!sync_file(tmp))
+    {
+        return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, ckpt, ec);
+    if (ec)
+    {
+        std::cerr << "could not replace poster checkpoint " << ckpt << ": " << ec.message() << "\n";
+        return false;
+    }
+    return true;
+}
+
+static bool read_checkpoint(const std::string &ckpt, mandlebrot::poster_job &job, poster_progress &progress)
+{
+    std::ifstream in(ckpt);
+    if (!in)
+    {
+        std::cerr << "could not open poster checkpoint " << ckpt << "\n";
+        return false;
+    }
+
+    std::string magic;
+    int version = 0;
+    in >> magic >> version;
+    if (magic != checkpoint_magic || version != checkpoint_version)
+    {
+        std::cerr << ckpt << " is not a version " << checkpoint_version << " poster checkpoint\n";
+        return false;
+    }
+    in >> std::ws;
+    std::getline(in, job.path);
+
+    size_t n_colors = 0;
+    in >> progress.width >> progress.band_rows
+       >> progress.histogram_samples >> progress.bailout >> job.order >> job.nIter
+       >> job.histogram_color >> job.modulo_blending
+       >> job.x_min >> job.x_max >> job.y_min >> job.y_max
+       >> n_colors;
+    job.colors.assign(n_colors, std::vector<unsigned char>(3));
+    for (auto &c : job.colors)
+    {
+        int red, green, blue;
+        in >> red >> green >> blue;
+        c[mandlebrot::RED]   = static_cast<unsigned char>(red);
+        c[mandlebrot::GREEN] = static_cast<unsigned char>(green);
+        c[mandlebrot::BLUE]  = static_cast<unsigned char>(blue);
+    }
+    in >> progress.bands_done >> progress.offset >> progress.adler;
+
+    if (!in || n_colors == 0 || progress.width <= 0 || progress.band_rows == 0 || progress.histogram_samples <= 0)
+    {
+        std::cerr << ckpt << " is malformed\n";
+        return false;
+    }
+    // escape_time reads BAILOUT_RADIUS from config.h, so it can't be carried over
+    if (progress.bailout != mandlebrot::BAILOUT_RADIUS)
+    {
+        std::cerr << ckpt << " was started with BAILOUT_RADIUS = " << progress.bailout
+                  << " but this build uses " << mandlebrot::BAILOUT_RADIUS << "\n";
+        return false;
+    }
+    return true;
+}
+
+//just enough of a PNG encoder to stream rows out and resume after an interruption.
+//IDAT holds a zlib stream whose deflate data is fully flushed at every band boundary,
+//so a fresh raw deflater can append to it as long as we carry the adler32 ourselves
+class png_stream
+{
+    public:
+        png_stream(std::ostream &stream, uLong start_adler)
+            : ok(false), adler(start_adler), out(stream), buffer(1 << 20)
+        {
+            strm.zalloc = Z_NULL;
+            strm.zfree  = Z_NULL;
+            strm.opaque = Z_NULL;
+            ok = deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+            strm.next_out  = buffer.data();
+            strm.avail_out = static_cast<uInt>(buffer.size());
+        }
+
+        ~png_stream()
+        {
+            if (ok)
+            {
+                deflateEnd(&strm);
+            }
+        }
+
+        static void write_chunk(std::ostream &out, const char *type, const unsigned char *data, size_t len)
+        {
+            unsigned char header[8];
+            put_u32(header, static_cast<uint32_t>(len));
+            std::copy(type, type + 4, header + 4);
+            uLong crc = crc32(0, header + 4, 4);
+            if (len > 0)
+            {
+                crc = crc32(crc, data, static_cast<uInt>(len));
+            }
+
+            unsigned char trailer[4];
+            put_u32(trailer, static_cast<uint32_t>(crc));
+
+            out.write(reinterpret_cast<const char *>(header), 8);
+            out.write(reinterpret_cast<const char *>(data), len);
+            out.write(reinterpret_cast<const char *>(trailer), 4);
+        }
+
+        //signature, header and the start of the zlib stream, everything before the first band
+        static void write_preamble(std::ostream &out, int width, int height)
+        {
+            static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+            out.write(reinterpret_cast<const char *>(signature), 8);
+
+            // 8 bit RGB, no interlacing
+            unsigned char ihdr[13] = {0};
+            put_u32(ihdr,     static_cast<uint32_t>(width));
+            put_u32(ihdr + 4, static_cast<uint32_t>(height));
+            ihdr[8] = 8;
+            ihdr[9] = 2;
+            write_chunk(out, "IHDR", ihdr, sizeof(ihdr));
+
+            // zlib header for a 32K window at the default level
+            static const unsigned char zlib_header[2] = {0x78, 0x9C};
+            write_chunk(out, "IDAT", zlib_header, sizeof(zlib_header));
+        }
+
+        //row must start with its filter byte
+        void write_row(const unsigned char *row, size_t len)
+        {
+            adler = adler32(adler, row, static_cast<uInt>(len));
+            strm.next_in  = const_cast<unsigned char *>(row);
+            strm.avail_in = static_cast<uInt>(len);
+            pump(Z_NO_FLUSH);
+        }
+
+        //byte align and drop the dictionary so the file can be cut here
+        void end_band()
+        {
+            pump(Z_FULL_FLUSH);
+        }
+
+        void finish()
+        {
+            pump(Z_FINISH);
+            unsigned char trailer[4];
+            put_u32(trailer, static_cast<uint32_t>(adler));
+            write_chunk(out, "IDAT", trailer, sizeof(trailer));
+            write_chunk(out, "IEND", nullptr, 0);
+        }
+
+        bool  ok;
+        uLong adler;
+
+    private:
+        static void put_u32(unsigned char *p, uint32_t v)
+        {
+            p[0] = static_cast<unsigned char>(v >> 24);
+            p[1] = static_cast<unsigned char>(v >> 16);
+            p[2] = static_cast<unsigned char>(v >> 8);
+            p[3] = static_cast<unsigned char>(v);
+        }
+
+        //each full output buffer becomes its own IDAT chunk
+        void emit()
+        {
+            const size_t used = buffer.size() - strm.avail_out;
+            if (used > 0)
+            {
+                write_chunk(out, "IDAT", buffer.data(), used);
+            }
+            strm.next_out  = buffer.data();
+            strm.avail_out = static_cast<uInt>(buffer.size());
+        }
+
+        void pump(int flush)
+        {
+            while (true)
+            {
+                deflate(&strm, flush);
+                if (strm.avail_out == 0)
+                {
+                    emit();
+                    continue;
+                }
+                // with no flush all the input is consumed, keep filling the buffer
+                if (flush != Z_NO_FLUSH)
+                {
+                    emit();
+                }
+                return;
+            }
+        }
+
+        std::ostream &out;
+        std::vector<unsigned char> buffer;
+        z_stream strm;
+};
+
+//renders a small copy of the whole view so every band buckets with the same global histogram
+static std::vector<double> poster_buckets(const mandlebrot::poster_job &job, int samples)
+{
+    const double x_inc   = (job.x_max - job.x_min) / samples;
+    const double y_inc   = (job.y_max - job.y_min) / samples;
+
+    std::vector<double> preview(static_cast<size_t>(samples) * samples);
+    #pragma omp parallel for collapse(2) schedule(dynamic, 512)
+    for (int i = 0; i < samples; i++)
+    {
+        for (int j = 0; j < samples; j++)
+        {
+            const auto cp = std::complex<double>(job.x_min+j*x_inc, job.y_max-i*y_inc);
+            preview[static_cast<size_t>(i)*samples+j] = mandlebrot::escape_time(cp, job.order, job.nIter);
+        }
+    }
+    return mandlebrot::histogram_buckets(job.colors, preview, static_cast<int>(job.nIter));
+}
+
+static bool render_bands(const mandlebrot::poster_job &job, poster_progress &progress,
+                         const std::atomic<bool> &cancel)
+{
+    const int    width   = progress.width;
+    const size_t n_bands = (width + progress.band_rows - 1) / progress.band_rows;
+    const double x_inc   = (job.x_max - job.x_min) / width;
+    const double y_inc   = (job.y_max - job.y_min) / width;
+    const int    nIter   = static_cast<int>(job.nIter);
+
+    // a shorter file was replaced or lost data, resize_file would pad it with zeros
+    std::error_code ec;
+    const std::uintmax_t size = std::filesystem::file_size(job.path, ec);
+    if (ec || size < progress.offset)
+    {
+        std::cerr << job.path << " is shorter than its checkpoint says, it can not be resumed\n";
+        return false;
+    }
+
+    // cut off whatever was written after the last checkpoint
+    std::filesystem::resize_file(job.path, progress.offset, ec);
+    if (ec)
+    {
+        std::cerr << "could not truncate " << job.path << ": " << ec.message() << "\n";
+        return false;
+    }
+    std::fstream out(job.path, std::ios::in | std::ios::out | std::ios::binary);
+    out.seekp(static_cast<std::streamoff>(progress.offset));
+    png_stream png(out, progress.adler);
+    if (!out || !png.ok)
+    {
+        std::cerr << "could not open " << job.path << " for writing\n";
+        return false;
+    }
+
+    std::vector<double> buckets;
+    if (job.histogram_color)
+    {
+        buckets = poster_buckets(job, progress.histogram_samples);
+    }
+
+    std::vector<double>        iterations(progress.band_rows * width);
+    std::vector<unsigned char> row(1 + 3 * static_cast<size_t>(width));
+
+    for (size_t band = progress.bands_done; band < n_bands; band++)
+    {
+        const int first_row = static_cast<int>(band * progress.band_rows);
+        const int rows      = std::min(static_cast<int>(progress.band_rows), width - first_row);
+
+        #pragma omp parallel for collapse(2) schedule(dynamic, 512)
+        for (int i = 0; i < rows; i++)
+        {
+            for (int j = 0; j < width; j++)
+            {
+                // a band can take minutes, so drain it quickly once cancelled
+                if (cancel.load(std::memory_order_relaxed))
+                {
+                    continue;
+                }
+                const auto cp = std::complex<double>(job.x_min+j*x_inc, job.y_max-(first_row+i)*y_inc);
+                iterations[static_cast<size_t>(i)*width+j] = mandlebrot::escape_time(cp, job.order, job.nIter);
+            }
+        }
+
+        // the checkpoint still points at the end of the last finished band
+        if (cancel)
+        {
+            poster_log("cancelled after band " + std::to_string(progress.bands_done) + " / " + std::to_string(n_bands)
+                       + ", resume with --resume-poster " + checkpoint_path(job.path));
+            return false;
+        }
+
+        for (int i = 0; i < rows; i++)
+        {
+            // no PNG filtering
+            row[0] = 0;
+            #pragma omp parallel for
+            for (int j = 0; j < width; j++)
+            {
+                const double iteration = iterations[static_cast<size_t>(i)*width+j];
+                unsigned char rgb[3];
+                if (job.histogram_color)
+                {
+                    mandlebrot::histogram_color(job.colors, buckets, iteration, nIter, rgb);
+                }
+                else
+                {
+                    mandlebrot::modulo_color(job.colors, iteration, nIter, job.modulo_blending, rgb);
+                }
+                row[1 + 3*j + 0] = rgb[mandlebrot::RED];
+                row[1 + 3*j + 1] = rgb[mandlebrot::GREEN];
+                row[1 + 3*j + 2] = rgb[mandlebrot::BLUE];
+            }
+            png.write_row(row.data(), row.size());
+        }
+
+        if (band + 1 == n_bands)
+        {
+            png.finish();
+        }
+        else
+        {
+            png.end_band();
+        }
+        if (!out.flush() || !sync_file(job.path))
+        {
+            std::cerr << "could not write " << job.path << "\n";
+            return false;
+        }
+
+        progress.bands_done = band + 1;
+        progress.offset     = static_cast<std::uintmax_t>(out.tellp());
+        progress.adler      = png.adler;
+        if (!write_checkpoint(job, progress))
+        {
+            return false;
+        }
+        poster_log("band " + std::to_string(progress.bands_done) + " / " + std::to_string(n_bands));
+    }
+
+    std::filesystem::remove(checkpoint_path(job.path), ec);
+    poster_log("wrote " + job.path);
+    return true;
+}
+
+bool mandlebrot::export_poster(const poster_job &job, const std::atomic<bool> &cancel)
+{
+    if (mandlebrot::poster_width <= 0 || job.colors.empty())
+    {
+        std::cerr << "poster: nothing to render\n";
+        return false;
+    }
+
+    poster_progress progress;
+    progress.width      = mandlebrot::poster_width;
+    progress.band_rows  = mandlebrot::poster_tile_budget / (sizeof(double) * progress.width);
+    progress.band_rows  = std::clamp<size_t>(progress.band_rows, 1, progress.width);
+    progress.bailout    = mandlebrot::BAILOUT_RADIUS;
+    progress.bands_done = 0;
+
+    // the preview and the sorted copy histogram_buckets makes of it share the same budget
+    const int budget_samples   = static_cast<int>(std::sqrt(mandlebrot::poster_tile_budget / (2 * sizeof(double))));
+    progress.histogram_samples = std::clamp(mandlebrot::poster_histogram_samples, 1, std::max(budget_samples, 1));
+    if (job.histogram_color && progress.histogram_samples < mandlebrot::poster_histogram_samples)
+    {
+        poster_log("histogram preview shrunk to " + std::to_string(progress.histogram_samples)
+                   + " wide to fit poster_tile_budget");
+    }
+
+    {
+        std::ofstream out(job.path, std::ios::out | std::ios::trunc | std::ios::binary);
+        png_stream::write_preamble(out, progress.width, progress.width);
+        progress.offset = static_cast<std::uintmax_t>(out.tellp());
+        if (!out.flush())
+        {
+            std::cerr << "could not write " << job.path << "\n";
+            return false;
+        }
+    }
+    if (!sync_file(job.path))
+    {
+        return false;
+    }
+    progress.adler = adler32(0, Z_NULL, 0);
+
+    if (!write_checkpoint(job, progress))
+    {
+        return false;
+    }
+    poster_log("rendering " + std::to_string(progress.width) + "x" + std::to_string(progress.width) + " to " + job.path
+               + ", resume with --resume-poster " + checkpoint_path(job.path) + " if interrupted");
+
+    return render_bands(job, progress, cancel);
+}
+
+bool mandlebrot::resume_poster(const std::string &checkpoint)
+{
+    // resuming runs in the foreground, interrupting it is as safe as cancelling
+    const std::atomic<bool> never(false);
+
+    poster_job      job;
+    poster_progress progress;
+    if (!read_checkpoint(checkpoint, job, progress))
+    {
+        return false;
+    }
+    poster_log("resuming " + job.path + " after band " + std::to_string(progress.bands_done));
+    return render_bands(job, progress, never);
+}
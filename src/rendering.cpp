@@ -2,8 +2,6 @@
 #include <cmath>
 #include <vector>
 
-#include <iostream>
-
 #include "config.h"
 #include "rendering.h"
 
@@ -11,9 +9,8 @@
 //similar iterations will be similar color and we will shade the difference
 //this way, in theory each 1/NUM_BUCKETS group will have a similar color
 //In theory, each Bucket should then have TOTAL_PIXELS/NUM_BUCKETS in it
-void mandlebrot::histogram_render (const std::vector< std::vector <unsigned char> > &current_colors,
-                                    const std::vector<double> &iterations, int nIter,
-                                    SDL_Renderer *renderer)
+std::vector<double> mandlebrot::histogram_buckets (const std::vector< std::vector <unsigned char> > &current_colors,
+                                                    const std::vector<double> &iterations, int nIter)
 {
 
     std::vector<double> temp(iterations);
@@ -45,53 +42,106 @@ void mandlebrot::histogram_render (const std::vector< std::vector <unsigned char
             }
         }
     }
+    return buckets;
+}
+
+void mandlebrot::histogram_color (const std::vector< std::vector <unsigned char> > &current_colors,
+                                   const std::vector<double> &buckets, double iteration, int nIter,
+                                   unsigned char rgb[3])
+{
+    if (iteration == nIter)
+    {
+        rgb[mandlebrot::RED]   = 0x00;
+        rgb[mandlebrot::GREEN] = 0x00;
+        rgb[mandlebrot::BLUE]  = 0x00;
+        return;
+    }
+
+    //find which bucket each pixel belongs to
+    size_t bucket_index, bucket2_index;
+    for (bucket_index = 0; bucket_index < buckets.size() - 1; bucket_index++)
+    {
+        if (iteration <= buckets[bucket_index])
+            break;
+    }
+
+    bucket2_index = bucket_index == 0 ? buckets.size() -1 : bucket_index - 1;
+
+    //the first bucket blends up from 0 iterations
+    const double lower = bucket_index == 0 ? 0.0 : buckets[bucket_index - 1];
+
+    //posters bucket from a smaller preview, so a pixel can escape past the last bucket
+    double blend = static_cast<double>(iteration - lower)
+            / static_cast<double>(buckets[bucket_index] - lower);
+    blend = std::clamp(blend, 0.0, 1.0);
+
+    rgb[mandlebrot::RED]   = static_cast<unsigned char>((1 - blend) * current_colors[bucket2_index][mandlebrot::RED]
+                             + blend * current_colors[bucket_index][mandlebrot::RED]);
+    rgb[mandlebrot::GREEN] = static_cast<unsigned char>((1 - blend) * current_colors[bucket2_index][mandlebrot::GREEN]
+                             + blend * current_colors[bucket_index][mandlebrot::GREEN]);
+    rgb[mandlebrot::BLUE]  = static_cast<unsigned char>((1 - blend) * current_colors[bucket2_index][mandlebrot::BLUE]
+                             + blend * current_colors[bucket_index][mandlebrot::BLUE]);
+}
+
+//color each pixel by the modulo of the iterations it took
+//this has the advantage of being zoom invariant, but can get messy
+void mandlebrot::modulo_color (const std::vector< std::vector <unsigned char> > &current_colors,
+                                double iteration, int nIter, double modulo_blend,
+                                unsigned char rgb[3])
+{
+    if (iteration == nIter)
+    {
+        rgb[mandlebrot::RED]   = 0x00;
+        rgb[mandlebrot::GREEN] = 0x00;
+        rgb[mandlebrot::BLUE]  = 0x00;
+        return;
+    }
+
+    int bucket_index  = static_cast<int>(std::floor(iteration / modulo_blend)) % current_colors.size();
+
+    int bucket2_index = (bucket_index + 1) % current_colors.size();
+
+    double tmp2;
+
+    for (tmp2 = 0; tmp2 < iteration - modulo_blend; tmp2 += modulo_blend)
+    {
+        ;
+    }
+
+    double blend = static_cast<double>(iteration - tmp2) / modulo_blend;
+
+    rgb[mandlebrot::RED]   = static_cast<unsigned char>((1 - blend) * current_colors[bucket_index][mandlebrot::RED]
+                             + blend * current_colors[bucket2_index][mandlebrot::RED]);
+
+    rgb[mandlebrot::GREEN] = static_cast<unsigned char>((1 - blend) * current_colors[bucket_index][mandlebrot::GREEN]
+                             + blend * current_colors[bucket2_index][mandlebrot::GREEN]);
+
+    rgb[mandlebrot::BLUE]  = static_cast<unsigned char>((1 - blend) * current_colors[bucket_index][mandlebrot::BLUE]
+                             + blend * current_colors[bucket2_index][mandlebrot::BLUE]);
+}
+
+void mandlebrot::histogram_render (const std::vector< std::vector <unsigned char> > &current_colors,
+                                    const std::vector<double> &iterations, int nIter,
+                                    SDL_Renderer *renderer)
+{
+    const std::vector<double> buckets = mandlebrot::histogram_buckets(current_colors, iterations, nIter);
 
     #pragma omp parallel for collapse(2)
     for (int i = 0; i < mandlebrot::pixelWidth; i++)
     {
         for (int j = 0; j < mandlebrot::pixelWidth; j++)
         {
-            char red, green, blue;
-            if (iterations[i * mandlebrot::pixelWidth + j] == nIter)
-            {
-                red   = 0x00;
-                green = 0x00;
-                blue  = 0x00;
-            }
-            else
-            {
-
-                //find which bucket each pixel belongs to
-                size_t bucket_index, bucket2_index;
-                for (bucket_index = 0; bucket_index < buckets.size() - 1; bucket_index++)
-                {
-                    if (iterations[i * mandlebrot::pixelWidth + j] <= buckets[bucket_index])
-                        break;
-                }
-
-                bucket2_index = bucket_index == 0 ? buckets.size() -1 : bucket_index - 1;
-
-                double blend = static_cast<double>(iterations[i * mandlebrot::pixelWidth + j] - buckets[bucket_index - 1])
-                        / static_cast<double>(buckets[bucket_index] - buckets[bucket_index - 1]);
-
-                red   = static_cast<char>((1 - blend) * current_colors[bucket2_index][mandlebrot::RED]
-                        + blend * current_colors[bucket_index][mandlebrot::RED]);
-                green = static_cast<char>((1 - blend) * current_colors[bucket2_index][mandlebrot::GREEN]
-                        + blend * current_colors[bucket_index][mandlebrot::GREEN]);
-                blue  = static_cast<char>((1 - blend) * current_colors[bucket2_index][mandlebrot::BLUE]
-                        + blend * current_colors[bucket_index][mandlebrot::BLUE]);
-            }
+            unsigned char rgb[3];
+            mandlebrot::histogram_color(current_colors, buckets, iterations[i * mandlebrot::pixelWidth + j], nIter, rgb);
             #pragma omp critical
             {
-                SDL_SetRenderDrawColor(renderer, red, green, blue, 0xFF);
+                SDL_SetRenderDrawColor(renderer, rgb[mandlebrot::RED], rgb[mandlebrot::GREEN], rgb[mandlebrot::BLUE], 0xFF);
                 SDL_RenderDrawPoint   (renderer, j, i);
             }
         }
     }
 }
 
-//color each pixel by the modulo of the iterations it took
-//this has the advantage of being zoom invariant, but can get messy
 void mandlebrot::modulo_render (const std::vector< std::vector <unsigned char> > &current_colors,
                                  const std::vector<double> &iterations, int nIter, double modulo_blend,
                                  SDL_Renderer *renderer)
@@ -101,43 +151,11 @@ void mandlebrot::modulo_render (const std::vector< std::vector <unsigned char> >
     {
         for (int j = 0; j < mandlebrot::pixelWidth; j++)
         {
-            char red, green, blue;
-            if (iterations[i * mandlebrot::pixelWidth + j] == nIter)
-            {
-                red   = 0x00;
-                green = 0x00;
-                blue  = 0x00;
-            }
-            else
-            {
-
-                int bucket_index  = static_cast<int>(std::floor(iterations[i * mandlebrot::pixelWidth + j]
-                                    / modulo_blend)) % current_colors.size();
-
-                int bucket2_index = (bucket_index + 1) % current_colors.size();
-
-                double tmp = iterations[i * mandlebrot::pixelWidth + j];
-                double tmp2;
-
-                for (tmp2 = 0; tmp2 < tmp - modulo_blend; tmp2 += modulo_blend)
-                {
-                    ;
-                }
-
-                double blend = static_cast<double>(iterations[i * mandlebrot::pixelWidth + j] - tmp2) / modulo_blend;
-
-                red   = static_cast<char>((1 - blend) * current_colors[bucket_index][mandlebrot::RED]
-                      + blend * current_colors[bucket2_index][mandlebrot::RED]);
-
-                green = static_cast<char>((1 - blend) * current_colors[bucket_index][mandlebrot::GREEN]
-                      + blend * current_colors[bucket2_index][mandlebrot::GREEN]);
-
-                blue  = static_cast<char>((1 - blend) * current_colors[bucket_index][mandlebrot::BLUE]
-                      + blend * current_colors[bucket2_index][mandlebrot::BLUE]);
-            }
+            unsigned char rgb[3];
+            mandlebrot::modulo_color(current_colors, iterations[i * mandlebrot::pixelWidth + j], nIter, modulo_blend, rgb);
             #pragma omp critical
             {
-                SDL_SetRenderDrawColor(renderer, red, green, blue, 0xFF);
+                SDL_SetRenderDrawColor(renderer, rgb[mandlebrot::RED], rgb[mandlebrot::GREEN], rgb[mandlebrot::BLUE], 0xFF);
                 SDL_RenderDrawPoint   (renderer, j, i);
             }
         }
@@ -0,0 +1,279 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "trace.h"
+
+//first line of every trace, pixelWidth is appended since mouse coordinates depend on it
+static const std::string trace_magic   = "mandlebrot_trace";
+static constexpr int     trace_version = 1;
+
+bool mandlebrot::operator==(const view_state &a, const view_state &b)
+{
+    return a.x_min           == b.x_min
+        && a.x_max           == b.x_max
+        && a.y_min           == b.y_min
+        && a.y_max           == b.y_max
+        && a.nIter           == b.nIter
+        && a.modulo_blending == b.modulo_blending
+        && a.histogram_color == b.histogram_color;
+}
+
+bool mandlebrot::operator!=(const view_state &a, const view_state &b)
+{
+    return !(a == b);
+}
+
+bool mandlebrot::is_traced_event(const SDL_Event &e)
+{
+    return e.type == SDL_QUIT || e.type == SDL_MOUSEBUTTONDOWN || e.type == SDL_KEYDOWN;
+}
+
+//the three event specific fields kept in a trace line
+//key presses only need the symbol, clicks need the button and location
+static void event_fields(const SDL_Event &e, long &a, long &b, long &c)
+{
+    a = b = c = 0;
+    if (e.type == SDL_MOUSEBUTTONDOWN)
+    {
+        a = e.button.button;
+        b = e.button.x;
+        c = e.button.y;
+    }
+    else if (e.type == SDL_KEYDOWN)
+    {
+        a = e.key.keysym.sym;
+    }
+}
+
+static SDL_Event make_event(Uint32 type, long a, long b, long c)
+{
+    SDL_Event e;
+    SDL_zero(e);
+    e.type = type;
+    if (type == SDL_MOUSEBUTTONDOWN)
+    {
+        e.button.button = static_cast<Uint8>(a);
+        e.button.state  = SDL_PRESSED;
+        e.button.clicks = 1;
+        e.button.x      = static_cast<Sint32>(b);
+        e.button.y      = static_cast<Sint32>(c);
+    }
+    else if (type == SDL_KEYDOWN)
+    {
+        e.key.state       = SDL_PRESSED;
+        e.key.keysym.sym  = static_cast<SDL_Keycode>(a);
+    }
+    return e;
+}
+
+static bool same_event(const SDL_Event &x, const SDL_Event &y)
+{
+    long xa, xb, xc, ya, yb, yc;
+    event_fields(x, xa, xb, xc);
+    event_fields(y, ya, yb, yc);
+    return x.type == y.type && xa == ya && xb == yb && xc == yc;
+}
+
+mandlebrot::trace_recorder::trace_recorder(const std::string &path)
+    : out(path), loop(0)
+{
+    if (!out)
+    {
+        std::cerr << "could not open trace file " << path << " for writing\n";
+        return;
+    }
+    // enough digits that the view round trips exactly
+    out.precision(std::numeric_limits<double>::max_digits10);
+    out << trace_magic << " " << trace_version << " " << mandlebrot::pixelWidth << "\n";
+}
+
+bool mandlebrot::trace_recorder::good() const
+{
+    return static_cast<bool>(out);
+}
+
+void mandlebrot::trace_recorder::tick()
+{
+    loop += 1;
+}
+
+//loop type a b c x_min x_max y_min y_max nIter modulo_blending histogram_color
+void mandlebrot::trace_recorder::record(const SDL_Event &e, const view_state &state)
+{
+    if (!is_traced_event(e))
+    {
+        return;
+    }
+    long a, b, c;
+    event_fields(e, a, b, c);
+
+    out << loop << " " << e.type << " " << a << " " << b << " " << c << " "
+        << state.x_min << " " << state.x_max << " " << state.y_min << " " << state.y_max << " "
+        << state.nIter << " " << state.modulo_blending << " " << state.histogram_color << std::endl;
+}
+
+mandlebrot::trace_player::trace_player(const std::string &path)
+    : loaded(false), loop(0), next_push(0), next_check(0), in_flight_begin(0), divergences(0)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        std::cerr << "could not open trace file " << path << " for reading\n";
+        return;
+    }
+
+    std::string line;
+    {
+        std::getline(in, line);
+        std::istringstream header(line);
+        std::string magic;
+        int version = 0, width = 0;
+        header >> magic >> version >> width;
+        if (magic != trace_magic || version != trace_version)
+        {
+            std::cerr << path << " is not a version " << trace_version << " trace\n";
+            return;
+        }
+        if (width != mandlebrot::pixelWidth)
+        {
+            std::cerr << path << " was recorded with pixelWidth = " << width
+                      << " but this build uses " << mandlebrot::pixelWidth << "\n";
+            return;
+        }
+    }
+
+    size_t line_number = 1;
+    while (std::getline(in, line))
+    {
+        line_number += 1;
+        if (line.empty())
+        {
+            continue;
+        }
+        std::istringstream fields(line);
+        entry en;
+        Uint32 type;
+        long   a, b, c;
+        int    histogram_color;
+        fields >> en.loop >> type >> a >> b >> c
+               >> en.state.x_min >> en.state.x_max >> en.state.y_min >> en.state.y_max
+               >> en.state.nIter >> en.state.modulo_blending >> histogram_color;
+        if (!fields || (!entries.empty() && en.loop < entries.back().loop))
+        {
+            std::cerr << path << ":" << line_number << ": malformed trace line\n";
+            return;
+        }
+        en.state.histogram_color = histogram_color;
+        en.event = make_event(type, a, b, c);
+        entries.push_back(en);
+    }
+    loaded = true;
+}
+
+bool mandlebrot::trace_player::good() const
+{
+    return loaded;
+}
+
+bool mandlebrot::trace_player::done() const
+{
+    return in_flight_begin == entries.size();
+}
+
+void mandlebrot::trace_player::frame_done()
+{
+    const auto now = std::chrono::steady_clock::now();
+    loop += 1;
+
+    // the main loop has handled everything pushed last time and rendered the result
+    if (in_flight_begin < next_push)
+    {
+        const double ms = std::chrono::duration<double, std::milli>(now - pushed_at).count();
+        latencies_ms.insert(latencies_ms.end(), next_push - in_flight_begin, ms);
+        in_flight_begin = next_push;
+        end = now;
+    }
+
+    if (loop == 1)
+    {
+        start = now;
+    }
+
+    // idle until the loop the next batch was recorded on, so refreshes happen as they did live
+    if (next_push == entries.size() || entries[next_push].loop > loop)
+    {
+        return;
+    }
+
+    pushed_at = now;
+    while (next_push < entries.size() && entries[next_push].loop <= loop)
+    {
+        SDL_Event e = entries[next_push].event;
+        SDL_PushEvent(&e);
+        next_push += 1;
+    }
+}
+
+void mandlebrot::trace_player::check(const SDL_Event &e, const view_state &state)
+{
+    if (!is_traced_event(e))
+    {
+        return;
+    }
+    if (next_check >= entries.size())
+    {
+        std::cerr << "replay: handled an event that is not in the trace\n";
+        divergences += 1;
+        return;
+    }
+    const entry &expected = entries[next_check];
+    if (!same_event(e, expected.event) || state != expected.state)
+    {
+        std::cerr << "replay: event " << next_check << " diverged from the recorded view\n";
+        divergences += 1;
+    }
+    next_check += 1;
+}
+
+bool mandlebrot::trace_player::report(std::ostream &os) const
+{
+    std::vector<double> sorted(latencies_ms);
+    std::sort(sorted.begin(), sorted.end());
+
+    //nearest rank percentile
+    const auto percentile = [&sorted] (double p)
+    {
+        if (sorted.empty())
+        {
+            return 0.0;
+        }
+        size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+        rank = rank == 0 ? 1 : rank;
+        return sorted[rank - 1];
+    };
+
+    const double session_s = sorted.empty() ? 0.0 :
+                             std::chrono::duration<double>(end - start).count();
+
+    os << "----------------------------------------------------------------------\n"
+       << std::fixed << std::setprecision(3)
+       << "replayed events = " << sorted.size() << " of " << entries.size() << "\n"
+       << "latency p50     = " << percentile(50)  << " ms\n"
+       << "latency p90     = " << percentile(90)  << " ms\n"
+       << "latency p99     = " << percentile(99)  << " ms\n"
+       << "latency max     = " << percentile(100) << " ms\n"
+       << "session time    = " << session_s << " s\n"
+       << "divergences     = " << divergences << std::endl;
+    os.unsetf(std::ios_base::floatfield);
+
+    return divergences == 0 && sorted.size() == entries.size();
+}